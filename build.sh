@@ -5,12 +5,25 @@
 #  @email:   douglvini@gmail.com
 # --------------------------------------
 
-if not [ -d "bin" ]
+if [ ! -d "bin" ]
 then
 	mkdir bin
 fi
 
+# the live telemetry and spectator stream are only turned on for Linux, shm_open needs librt there.
+MODES=""
+MODE_LIBS=""
+if [ "$(uname)" = "Linux" ]
+then
+	MODES="-DTELEMETRY_MODE=1 -DSPECTATOR_MODE=1"
+	MODE_LIBS="-lrt"
+fi
+
 # @todo turn on warnings
-cc -DDEBUG_MODE=1 -g smoking_snake.c -o bin/smoking_snake -lSDL2 -lm
-#cc -DDEBUG_MODE=0 -O2 smoking_snake.c -o bin/smoking_snake -lSDL2 -lm
+cc -DDEBUG_MODE=1 $MODES -g smoking_snake.c -o bin/smoking_snake -lSDL2 -lm $MODE_LIBS
+#cc -DDEBUG_MODE=0 $MODES -O2 smoking_snake.c -o bin/smoking_snake -lSDL2 -lm $MODE_LIBS
+if [ "$(uname)" = "Linux" ]
+then
+	cc -g telemetry_reader.c -o bin/telemetry_reader $MODE_LIBS
+fi
 echo __DONE__
@@ -8,11 +8,27 @@
 
 #include <SDL2/SDL.h>
 
+#if TELEMETRY_MODE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "telemetry.h"
+#endif
+#if SPECTATOR_MODE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 // some type redefinition of my preference.
 typedef unsigned long long u64;
 typedef unsigned int b32;
 typedef unsigned int u32;
 typedef unsigned char u8;
+typedef signed char s8;
 typedef int s32;
 typedef short s16;
 typedef unsigned short u16;
@@ -35,6 +51,10 @@ typedef unsigned short u16;
 #else
 #define ASSERT(...)
 #endif
+// @note TELEMETRY_MODE publish some per frame counters in a shm segment (see telemetry.h and telemetry_reader.c).
+// if the segment can't be created the game just runs without it.
+// @note SPECTATOR_MODE streams the game state over a UNIX socket and adds "--spectate <pid>" to watch it.
+// same as the telemetry, if the socket can't be created the game just runs without it.
 
 //
 // Data layout
@@ -49,42 +69,150 @@ Color make_color(float r, float g, float b, float a)
 	return result;
 }
 Color color_mul(float a, Color b) {return make_color(a*b.r, a*b.g, a*b.b, a*b.a);}
+// sRGB <-> linear light lookup tables, filled by init_color_tables.
+// @note Color values are sRGB encoded, blending and interpolation happens in linear light.
+#define LINEAR_TO_SRGB_TABLE_SIZE 4096
+float srgb_to_linear_table[256];
+u8 linear_to_srgb_table[LINEAR_TO_SRGB_TABLE_SIZE];
+void init_color_tables()
+{
+	for (s32 i=0; i < 256; i++)
+	{
+		float srgb = (float)i / 255.0f;
+		if (srgb <= 0.04045f) srgb_to_linear_table[i] = srgb / 12.92f;
+		else srgb_to_linear_table[i] = powf((srgb + 0.055f) / 1.055f, 2.4f);
+	}
+	for (s32 i=0; i < LINEAR_TO_SRGB_TABLE_SIZE; i++)
+	{
+		float linear = (float)i / (float)(LINEAR_TO_SRGB_TABLE_SIZE-1);
+		float srgb;
+		if (linear <= 0.0031308f) srgb = linear * 12.92f;
+		else srgb = 1.055f * powf(linear, 1.0f/2.4f) - 0.055f;
+		linear_to_srgb_table[i] = (u8)(srgb*255.0f + 0.5f);
+	}
+}
+float u8_to_linear(u32 value) {return srgb_to_linear_table[value & 0xff];}
+u32 linear_to_u8(float linear)
+{
+	if (linear <= 0) return 0;
+	if (linear >= 1.0f) return 255;
+	return linear_to_srgb_table[(u32)(linear*(LINEAR_TO_SRGB_TABLE_SIZE-1) + 0.5f)];
+}
+float srgb_to_linear(float srgb)
+{
+	if (srgb <= 0) return 0;
+	if (srgb >= 1.0f) return 1.0f;
+	return srgb_to_linear_table[(u32)(srgb*255.0f + 0.5f)];
+}
+float linear_to_srgb(float linear) {return (float)linear_to_u8(linear) / 255.0f;}
+
 Color color_lerp(Color from, float t, Color to)
 {
-	// @todo this is not the correct way to interpolate colors.
-	Color factor_a = color_mul((1.0f -t), from);
-	Color factor_b = color_mul((t), to);
-	Color result = make_color(factor_a.r + factor_b.r,
-			factor_a.g + factor_b.g,
-			factor_a.b + factor_b.b,
-			factor_a.a + factor_b.a);
+	// interpolating in linear light, alpha is already linear.
+	Color result = make_color(linear_to_srgb((1.0f -t)*srgb_to_linear(from.r) + t*srgb_to_linear(to.r)),
+			linear_to_srgb((1.0f -t)*srgb_to_linear(from.g) + t*srgb_to_linear(to.g)),
+			linear_to_srgb((1.0f -t)*srgb_to_linear(from.b) + t*srgb_to_linear(to.b)),
+			(1.0f -t)*from.a + t*to.a);
 	return  result;
 }
 u32 color_to_u32(Color color)
 {
-	u32 result = ((u32)(color.a*255.0) << 24 |
-			(u32)(color.r*255.0) << 16|
-			(u32)(color.g*255.0) << 8 |
-			(u32)(color.b*255.0));
+	u32 result = ((u32)(color.a*255.0f + 0.5f) << 24 |
+			(u32)(color.r*255.0f + 0.5f) << 16|
+			(u32)(color.g*255.0f + 0.5f) << 8 |
+			(u32)(color.b*255.0f + 0.5f));
 	return result;
 }
-u32 alpha_blend(u32 dest_u32_color, Color src_premul_color, float alpha)
+
+//renderer
+// Pixel format kernels.
+// @note every supported SDL_Surface format has its own pack/blend procs and DEFINE_PIXEL_KERNELS generates the
+// row fill and pixel blend on top of them, so the primitives never branch on the pixel format per pixel.
+// The kernel set is picked once when the Pixmap is created.
+typedef struct
+{
+	s32 bytes_per_pixel;
+	u32 (*pack_color)(Color color);
+	void (*fill_row)(u8* row, s32 count, u32 packed_color);
+	void (*blend_pixel)(u8* pixel, Color src_premul_color, float alpha); // src_premul_color is in linear light.
+}PixelKernels;
+
+#define DEFINE_PIXEL_KERNELS(name, pixel_type) \
+	void name##_fill_row(u8* row, s32 count, u32 packed_color) \
+	{ \
+		pixel_type* pixel = (pixel_type*)row; \
+		pixel_type value = (pixel_type)packed_color; \
+		for (s32 _x=0; _x < count; _x++) *pixel++ = value; \
+	} \
+	void name##_blend_pixel(u8* pixel, Color src_premul_color, float alpha) \
+	{ \
+		*(pixel_type*)pixel = (pixel_type)name##_blend(*(pixel_type*)pixel, src_premul_color, alpha); \
+	} \
+	PixelKernels name##_kernels = {sizeof(pixel_type), name##_pack_color, name##_fill_row, name##_blend_pixel};
+
+// 0xXX_RR_GG_BB, the pad byte is left untouched by the blend.
+u32 xrgb8888_pack_color(Color color) {return color_to_u32(color);}
+u32 xrgb8888_blend(u32 dest_u32_color, Color src_premul_color, float alpha)
 {
-	Color dest_color = make_color((float)((dest_u32_color >> 16) & 0xff),
-			(float)((dest_u32_color >> 8) & 0xff),
-			(float)(dest_u32_color & 0xff), 1.0);
-	dest_color = color_mul(1.0 - alpha, dest_color);
+	float dest_factor = 1.0f - alpha;
+	u32 r = linear_to_u8(dest_factor*u8_to_linear(dest_u32_color >> 16) + src_premul_color.r);
+	u32 g = linear_to_u8(dest_factor*u8_to_linear(dest_u32_color >> 8) + src_premul_color.g);
+	u32 b = linear_to_u8(dest_factor*u8_to_linear(dest_u32_color) + src_premul_color.b);
+	u32 result = (dest_u32_color & 0xff000000) | (r << 16) | (g << 8) | b;
+	return result;
+}
+DEFINE_PIXEL_KERNELS(xrgb8888, u32)
 
-	dest_color.r = dest_color.r + src_premul_color.r;
-	dest_color.g = dest_color.g + src_premul_color.g;
-	dest_color.b = dest_color.b + src_premul_color.b;
+// 0xAA_RR_GG_BB, alpha is composited as well.
+u32 argb8888_pack_color(Color color) {return color_to_u32(color);}
+u32 argb8888_blend(u32 dest_u32_color, Color src_premul_color, float alpha)
+{
+	float dest_factor = 1.0f - alpha;
+	u32 a = (u32)((dest_factor*((dest_u32_color >> 24) & 0xff) + alpha*255.0f) + 0.5f);
+	u32 r = linear_to_u8(dest_factor*u8_to_linear(dest_u32_color >> 16) + src_premul_color.r);
+	u32 g = linear_to_u8(dest_factor*u8_to_linear(dest_u32_color >> 8) + src_premul_color.g);
+	u32 b = linear_to_u8(dest_factor*u8_to_linear(dest_u32_color) + src_premul_color.b);
+	u32 result = (a << 24) | (r << 16) | (g << 8) | b;
+	return result;
+}
+DEFINE_PIXEL_KERNELS(argb8888, u32)
 
-	// @note this may be writting in SDL buffer pad byte, can this cause problems??
-	u32 result = ((u32)dest_color.r << 16) | ((u32)dest_color.g << 8) | ((u32)dest_color.b);
+// RRRRR_GGGGGG_BBBBB
+u32 rgb565_pack_color(Color color)
+{
+	u32 result = ((u32)(color.r*31.0f + 0.5f) << 11 |
+			(u32)(color.g*63.0f + 0.5f) << 5 |
+			(u32)(color.b*31.0f + 0.5f));
+	return result;
+}
+u32 rgb565_blend(u32 dest_u32_color, Color src_premul_color, float alpha)
+{
+	float dest_factor = 1.0f - alpha;
+	// expanding the channels to 8 bits so they can go through the linear tables.
+	u32 dest_r = ((dest_u32_color >> 11) & 0x1f) * 255 / 31;
+	u32 dest_g = ((dest_u32_color >> 5) & 0x3f) * 255 / 63;
+	u32 dest_b = (dest_u32_color & 0x1f) * 255 / 31;
+	u32 r = linear_to_u8(dest_factor*u8_to_linear(dest_r) + src_premul_color.r) * 31 / 255;
+	u32 g = linear_to_u8(dest_factor*u8_to_linear(dest_g) + src_premul_color.g) * 63 / 255;
+	u32 b = linear_to_u8(dest_factor*u8_to_linear(dest_b) + src_premul_color.b) * 31 / 255;
+	u32 result = (r << 11) | (g << 5) | b;
+	return result;
+}
+DEFINE_PIXEL_KERNELS(rgb565, u16)
+
+// returns 0 if there are no kernels for the given SDL_PixelFormatEnum.
+PixelKernels* get_pixel_kernels(u32 sdl_pixel_format)
+{
+	PixelKernels* result = 0;
+	switch (sdl_pixel_format)
+	{
+		case SDL_PIXELFORMAT_RGB888: result = &xrgb8888_kernels; break; // this is the XRGB8888 one.
+		case SDL_PIXELFORMAT_ARGB8888: result = &argb8888_kernels; break;
+		case SDL_PIXELFORMAT_RGB565: result = &rgb565_kernels; break;
+	}
 	return result;
 }
 
-//renderer
 // @note Pixmap is here just because i may decide draw a Pixmap into a Pixmap later instead of drawing everything
 // into the SDL_Surface always.
 typedef struct
@@ -92,11 +220,23 @@ typedef struct
 	u32 width;
 	u32 height;
 	s32 pitch;
-	// SDL_Surface: 0xXX_RR_GG_BB || Pixmap: 0xAA_RR_GG_BB.
-	b32 ro_alpha; // read only alpha. This may cause @speed problems.
+	PixelKernels* kernels;
 	u8* pixels;
 }Pixmap;
 
+// the game colors already packed in the backbuffer pixel format, built once per frame so the
+// primitives don't have to convert a Color for each draw call.
+typedef struct
+{
+	u32 background;
+	u32 grid;
+	u32 food;
+	u32 snake_head;
+	u32 snake_body;
+	u32 game_over_snake_head; // the snake oscillate color when the game is over.
+	u32 game_over_snake_body;
+}Palette;
+
 // input
 typedef struct
 {
@@ -170,6 +310,7 @@ typedef struct
 #define MAX_FOOD_COUNT 16
 #define MAX_INPUT_QUEUE 3
 #define RESTART_TIME 5.0f
+#define HIDDEN_TICKS_PER_WAKE 6 // game ticks per wake up while the window is hidden or minimized.
 enum
 {
 	Input_None,
@@ -203,9 +344,9 @@ typedef struct
 //
 // Renderer procs
 //
-void draw_solid_rectangle(Pixmap* pixmap, s32 pos_x, s32 pos_y, s32 width, s32 height, Color color)
+// @note packed_color must be in the pixmap format (see PixelKernels.pack_color).
+void draw_solid_rectangle(Pixmap* pixmap, s32 pos_x, s32 pos_y, s32 width, s32 height, u32 packed_color)
 {
-	u32 color_u32 = color_to_u32(color);
 	// clipping the rectangle.
 	s32 min_x = pos_x;
 	s32 min_y = pos_y;
@@ -220,42 +361,36 @@ void draw_solid_rectangle(Pixmap* pixmap, s32 pos_x, s32 pos_y, s32 width, s32 h
 	if (max_y < 0) max_y = 0;
 	if (max_y > pixmap->height) max_y = pixmap->height;
 
-	u8* start_row = (u8*)pixmap->pixels + min_y * pixmap->pitch;
+	s32 bytes_per_pixel = pixmap->kernels->bytes_per_pixel;
+	u8* start_row = (u8*)pixmap->pixels + min_y * pixmap->pitch + min_x * bytes_per_pixel;
 	for (s32 _y=0; _y < (max_y-min_y); _y++)
 	{
-		u32* pixel = (u32*)(start_row + _y*pixmap->pitch) + min_x;
-		for (s32 _x=0; _x < (max_x-min_x); _x++)
-		{
-			*pixel++ = color_u32;
-		}
+		pixmap->kernels->fill_row(start_row + _y*pixmap->pitch, max_x-min_x, packed_color);
 	}
 }
 
 void draw_line(Pixmap* pixmap, Vec2 pos_a, Vec2 pos_b, Color color)
 {
-	Color premul_color = color_mul(color.a*255.0, color);
+	Color premul_color = make_color(color.a*srgb_to_linear(color.r), color.a*srgb_to_linear(color.g),
+			color.a*srgb_to_linear(color.b), color.a);
 	Vec2 displacement = vec2_sub(pos_b, pos_a);
 	float distance = vec2_length(displacement);
 	Vec2 dir = vec2_normalize(displacement);
 
+	s32 bytes_per_pixel = pixmap->kernels->bytes_per_pixel;
 	for (s32 forward=0; forward < (s32)distance; forward++)
 	{
 		Vec2 pos = vec2_add(vec2_mul((float)forward, dir), pos_a);
 		if ((pos.x >= 0 && pos.x < pixmap->width) && (pos.y >= 0 && pos.y < pixmap->height))
 		{
-			u32* pixel = (u32*)((u8*)pixmap->pixels + (s32)pos.y * pixmap->pitch) + (s32)pos.x;
-
-			u32 dest_u32_color = *pixel;
-			u32 dest_color = alpha_blend(dest_u32_color, premul_color, color.a);
-			*pixel = dest_color;
+			u8* pixel = (u8*)pixmap->pixels + (s32)pos.y * pixmap->pitch + (s32)pos.x * bytes_per_pixel;
+			pixmap->kernels->blend_pixel(pixel, premul_color, color.a);
 		}
 	}
 }
 
-void draw_circle(Pixmap* pixmap, float radius, float pos_x, float pos_y, Color color)
+void draw_circle(Pixmap* pixmap, float radius, float pos_x, float pos_y, u32 packed_color)
 {
-	u32 color_u32 = color_to_u32(color);
-	// @todo @speed try to implement Bresenham's circle algorithm to speed this up.
 	// - this should have an alpha blend
 	float min_x = pos_x - radius;
 	float min_y = pos_y - radius;
@@ -270,17 +405,31 @@ void draw_circle(Pixmap* pixmap, float radius, float pos_x, float pos_y, Color c
 	if (max_y < 0) max_y = 0;
 	if (max_y > pixmap->height) max_y = (float)pixmap->height;
 
-	u8* start_row = (u8*)pixmap->pixels + (s32)min_y * pixmap->pitch;
-	for (s32 _y=0; _y < (s32)(max_y-min_y)+1; _y++)
+	// every row of the circle is a single span, so the inside test is solved once per row and the span is filled
+	// by the kernel instead of testing the distance for every pixel.
+	s32 bytes_per_pixel = pixmap->kernels->bytes_per_pixel;
+	s32 last_x = (s32)(max_x-min_x);
+	if ((s32)min_x + last_x >= (s32)pixmap->width) last_x = (s32)pixmap->width - (s32)min_x - 1;
+	s32 last_y = (s32)(max_y-min_y);
+	if ((s32)min_y + last_y >= (s32)pixmap->height) last_y = (s32)pixmap->height - (s32)min_y - 1;
+
+	u8* start_row = (u8*)pixmap->pixels + (s32)min_y * pixmap->pitch + (s32)min_x * bytes_per_pixel;
+	for (s32 _y=0; _y <= last_y; _y++)
 	{
-		u32* pixel = (u32*)(start_row + _y*pixmap->pitch) + (s32)min_x;
-		for (s32 _x=0; _x < (s32)(max_x-min_x)+1; _x++)
-		{
-			Vec2 displacement = vec2_sub(vec2(pos_x, pos_y), vec2_add(vec2(_x, _y), vec2(min_x, min_y)));
-			float distance = vec2_length(displacement);
-			if (distance < radius) *pixel = color_u32;
-			pixel++;
-		}
+		float distance_y = pos_y - ((float)_y + min_y);
+		float half_span_sq = radius*radius - distance_y*distance_y;
+		if (half_span_sq <= 0) continue;
+		float half_span = sqrtf(half_span_sq);
+
+		// pixels where |pos_x - (_x + min_x)| < half_span.
+		s32 first = (s32)floorf(pos_x - min_x - half_span) + 1;
+		s32 last = (s32)ceilf(pos_x - min_x + half_span) - 1;
+		if (first < 0) first = 0;
+		if (last > last_x) last = last_x;
+		if (first > last) continue;
+
+		u8* row = start_row + _y*pixmap->pitch + first * bytes_per_pixel;
+		pixmap->kernels->fill_row(row, last-first+1, packed_color);
 	}
 }
 
@@ -330,14 +479,28 @@ Vec2 get_cell_pos(Game* game, GridPos pos)
 	return result;
 }
 
-void game_tick(Pixmap* backbuffer, Game* game, Input* input, float dt)
+void setup_grid(Game* game)
+{
+	game->grid_center = vec2_mul(0.5f, vec2(WINDOW_WIDTH, WINDOW_HEIGHT));
+	game->cell_size = (float)WINDOW_WIDTH/(float)CELL_COUNT;
+}
+
+// how much of a eaten food is inside a snake part, 1.0 when the food is exactly at the part position.
+float get_belly_full(Food* food, SnakePart* part)
+{
+	float result = 0;
+	if (is_grid_pos_equal(food->pos, part->from_pos)) result = 1.0 - part->pos_t;
+	else if (is_grid_pos_equal(food->pos, part->to_pos)) result = part->pos_t;
+	return result;
+}
+
+void game_update(Game* game, Input* input, float dt)
 {
 	if (!game->initialized)
 	{
 		game->initialized = true;
 
-		game->grid_center = vec2_mul(0.5f, vec2(WINDOW_WIDTH, WINDOW_HEIGHT));
-		game->cell_size = (float)WINDOW_WIDTH/(float)CELL_COUNT;
+		setup_grid(game);
 
 		game->game_over = false;
 		game->restart_timer = 0;
@@ -392,59 +555,6 @@ void game_tick(Pixmap* backbuffer, Game* game, Input* input, float dt)
 		}
 	}
 
-	// Setting colors
-#if 1
-	Color background_color = make_color(0.32f, 0, 0.3, 1.0f);
-	Color grid_color = make_color(0.5, 0, 0.4, 1.0);
-	Color snake_color_0 = make_color(0.65, 0.55, 0, 1);
-	Color snake_color_1 = make_color(0.15f, 0.55f, 0, 1);
-	Color snake_color_2 = snake_color_1;
-#else
-	Color background_color = make_color(0, 0.25, 0.20, 1.0f);
-	Color grid_color = make_color(0.1, 0.32, 0.32, 1.0);
-	Color snake_color_0 = make_color(0.70, 0.30, 0, 1);
-	Color snake_color_1 = make_color(0.45f, 0, 0.67, 1);
-	Color snake_color_2 = snake_color_1;
-#endif
-	Color food_color = make_color(0.8, 0.2, 0, 1.0);
-
-	// clearing the screen
-	draw_solid_rectangle(backbuffer, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, background_color);
-
-#if 1
-	// drawing a grid
-	/*
-	for (s32 cell_y=-HALF_CELL_COUNT; cell_y <= HALF_CELL_COUNT; cell_y++)
-	{
-		for (s32 cell_x=-HALF_CELL_COUNT; cell_x <= HALF_CELL_COUNT; cell_x++)
-		{
-			Vec2 pos = get_cell_pos(game, grid_pos(cell_x, cell_y));
-			Color color = make_color(0, 0, 0, 0.3);
-			float margin = 2.0f;
-			Vec2 offset = vec2(-0.5 * game->cell_size + margin, -0.5* game->cell_size + margin);
-			pos = vec2_add(pos, offset);
-			draw_rectangle(backbuffer, pos.x, pos.y, game->cell_size-2*margin,
-					game->cell_size-2*margin, color);
-			//draw_circle(backbuffer, 0.5*game->cell_size - margin, pos.x, pos.y, get_u32_color(color));
-		}
-	}
-	*/
-	for (s32 count=0; count < CELL_COUNT; count++)
-	{
-		// @todo merge these two loops.
-		Vec2 pos_a = vec2(count * game->cell_size, 0);
-		Vec2 pos_b = vec2(count * game->cell_size, backbuffer->height);
-		draw_solid_rectangle(backbuffer, pos_a.x, 0, 1, backbuffer->height, grid_color);
-	}
-	for (s32 count=0; count < CELL_COUNT; count++)
-	{
-		Vec2 pos_a = vec2(0, count * game->cell_size);
-		Vec2 pos_b = vec2(backbuffer->width, count * game->cell_size);
-		draw_solid_rectangle(backbuffer, 0, pos_a.y, backbuffer->width, 1, grid_color);
-	}
-
-#endif
-
 	// spawning some food.
 	if (game->food_spawn_timer <= 0)
 	{
@@ -480,26 +590,18 @@ void game_tick(Pixmap* backbuffer, Game* game, Input* input, float dt)
 		}
 	}
 
-	{// drawing all the food
-		float value = sin((2*M_PI) * game->time_count);
-		value = (value + 1.0)/2.0; // mapping -1/1 to 0/1
-		food_color = color_lerp(make_color(1, 1, 0, 1), value, food_color);
-		float food_size = 0.2 * game->cell_size + ((1.0 - value) * 5);
-
-		for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+	// food timers.
+	for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+	{
+		Food* food = game->food_list + fi;
+		if (food->active && !food->eaten)
 		{
-			Food* food = game->food_list + fi;
-			if (food->active && !food->eaten)
-			{
-				Vec2 food_pos = get_cell_pos(game, food->pos);
-				draw_circle(backbuffer, 0.5*food_size, food_pos.x, food_pos.y, food_color);
-				food->timer -= dt;
-				if (food->timer < 0) food->active = false;
-			}
+			food->timer -= dt;
+			if (food->timer < 0) food->active = false;
 		}
 	}
 
-	// drawing the snake parts.
+	// moving the snake parts.
 	for (s32 si=0; si < game->snake_part_count; si++)
 	{
 		SnakePart* part = game->snake + si;
@@ -565,6 +667,183 @@ void game_tick(Pixmap* backbuffer, Game* game, Input* input, float dt)
 			}
 		}
 
+		// growing the snake when a food reaches the tail.
+		for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+		{
+			Food* food = game->food_list + fi;
+			if (food->active && food->eaten && (si == game->snake_part_count -1) &&
+					get_belly_full(food, part) == 1.0f)
+			{
+				grow_snake(game, part->from_pos);
+				food->eaten = false;
+				food->active = false;
+			}
+		}
+
+		if (!game->game_over) part->pos_t += (speed_mod * 6.8f) * dt;
+	}
+	if (game->game_over)
+	{
+		game->restart_timer -= dt;
+		if (game->restart_timer < 0) game->initialized = false;
+	}
+}
+
+// FNV-1a style hash taking 8 bytes per step, used to tell if two frames would render the same.
+u64 hash_bytes(u64 hash, void* data, u32 size)
+{
+	u8* bytes = data;
+	u32 word_count = size / 8;
+	for (u32 i=0; i < word_count; i++)
+	{
+		u64 word;
+		memcpy(&word, bytes + i*8, 8);
+		hash ^= word;
+		hash *= 1099511628211ull;
+		hash ^= hash >> 29;
+	}
+	for (u32 i=word_count*8; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// if frame_hash isn't null the frame is only drawn when its inputs changed since the frame that wrote frame_hash,
+// set *frame_hash to 0 to force a redraw. Returns false if nothing was drawn.
+b32 game_render(Pixmap* backbuffer, Game* game, u64* frame_hash)
+{
+	// Setting colors
+#if 1
+	Color background_color = make_color(0.32f, 0, 0.3, 1.0f);
+	Color grid_color = make_color(0.5, 0, 0.4, 1.0);
+	Color snake_color_0 = make_color(0.65, 0.55, 0, 1);
+	Color snake_color_1 = make_color(0.15f, 0.55f, 0, 1);
+	Color snake_color_2 = snake_color_1;
+#else
+	Color background_color = make_color(0, 0.25, 0.20, 1.0f);
+	Color grid_color = make_color(0.1, 0.32, 0.32, 1.0);
+	Color snake_color_0 = make_color(0.70, 0.30, 0, 1);
+	Color snake_color_1 = make_color(0.45f, 0, 0.67, 1);
+	Color snake_color_2 = snake_color_1;
+#endif
+	Color food_color = make_color(0.8, 0.2, 0, 1.0);
+	Color pulse_color = make_color(1, 1, 0, 1);
+
+	// the animated colors are the same for every primitive so they are only computed once per frame.
+	float food_pulse = sin((2*M_PI) * game->time_count);
+	food_pulse = (food_pulse + 1.0)/2.0; // mapping -1/1 to 0/1
+	float snake_pulse = sin((4*M_PI) * game->time_count);
+	snake_pulse = (snake_pulse + 1.0)/2.0;
+
+	Palette palette;
+	PixelKernels* kernels = backbuffer->kernels;
+	palette.background = kernels->pack_color(background_color);
+	palette.grid = kernels->pack_color(grid_color);
+	palette.food = kernels->pack_color(color_lerp(pulse_color, food_pulse, food_color));
+	palette.snake_head = kernels->pack_color(snake_color_0);
+	palette.snake_body = kernels->pack_color(snake_color_1);
+	palette.game_over_snake_head = kernels->pack_color(color_lerp(pulse_color, snake_pulse, snake_color_0));
+	palette.game_over_snake_body = kernels->pack_color(color_lerp(pulse_color, snake_pulse, snake_color_1));
+	float food_size = 0.2 * game->cell_size + ((1.0 - food_pulse) * 5);
+
+	if (frame_hash)
+	{
+		// hashing only what the primitives below will actually draw, this is way cheaper than rasterizing an
+		// unchanged frame.
+		u64 hash = 14695981039346656037ull;
+		hash = hash_bytes(hash, &palette.background, sizeof(palette.background));
+		hash = hash_bytes(hash, &palette.grid, sizeof(palette.grid));
+		b32 has_visible_food = false;
+		for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+		{
+			Food* food = game->food_list + fi;
+			if (food->active)
+			{
+				// eaten food is not drawn but it still makes the snake belly bigger.
+				hash = hash_bytes(hash, &food->pos, sizeof(food->pos));
+				hash = hash_bytes(hash, &food->eaten, sizeof(food->eaten));
+				if (!food->eaten) has_visible_food = true;
+			}
+		}
+		if (has_visible_food)
+		{
+			hash = hash_bytes(hash, &palette.food, sizeof(palette.food));
+			hash = hash_bytes(hash, &food_size, sizeof(food_size));
+		}
+		if (game->game_over)
+		{
+			hash = hash_bytes(hash, &palette.game_over_snake_head, sizeof(palette.game_over_snake_head));
+			hash = hash_bytes(hash, &palette.game_over_snake_body, sizeof(palette.game_over_snake_body));
+		}
+		else
+		{
+			hash = hash_bytes(hash, &palette.snake_head, sizeof(palette.snake_head));
+			hash = hash_bytes(hash, &palette.snake_body, sizeof(palette.snake_body));
+		}
+		hash = hash_bytes(hash, &game->snake_part_count, sizeof(game->snake_part_count));
+		hash = hash_bytes(hash, game->snake, game->snake_part_count * sizeof(SnakePart));
+		if (hash == 0) hash = 1; // 0 is reserved for forcing a redraw.
+
+		if (hash == *frame_hash) return false;
+		*frame_hash = hash;
+	}
+
+	// clearing the screen
+	draw_solid_rectangle(backbuffer, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, palette.background);
+
+#if 1
+	// drawing a grid
+	/*
+	for (s32 cell_y=-HALF_CELL_COUNT; cell_y <= HALF_CELL_COUNT; cell_y++)
+	{
+		for (s32 cell_x=-HALF_CELL_COUNT; cell_x <= HALF_CELL_COUNT; cell_x++)
+		{
+			Vec2 pos = get_cell_pos(game, grid_pos(cell_x, cell_y));
+			Color color = make_color(0, 0, 0, 0.3);
+			float margin = 2.0f;
+			Vec2 offset = vec2(-0.5 * game->cell_size + margin, -0.5* game->cell_size + margin);
+			pos = vec2_add(pos, offset);
+			draw_rectangle(backbuffer, pos.x, pos.y, game->cell_size-2*margin,
+					game->cell_size-2*margin, color);
+			//draw_circle(backbuffer, 0.5*game->cell_size - margin, pos.x, pos.y, get_u32_color(color));
+		}
+	}
+	*/
+	for (s32 count=0; count < CELL_COUNT; count++)
+	{
+		// @todo merge these two loops.
+		Vec2 pos_a = vec2(count * game->cell_size, 0);
+		Vec2 pos_b = vec2(count * game->cell_size, backbuffer->height);
+		draw_solid_rectangle(backbuffer, pos_a.x, 0, 1, backbuffer->height, palette.grid);
+	}
+	for (s32 count=0; count < CELL_COUNT; count++)
+	{
+		Vec2 pos_a = vec2(0, count * game->cell_size);
+		Vec2 pos_b = vec2(backbuffer->width, count * game->cell_size);
+		draw_solid_rectangle(backbuffer, 0, pos_a.y, backbuffer->width, 1, palette.grid);
+	}
+
+#endif
+
+	{// drawing all the food
+		for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+		{
+			Food* food = game->food_list + fi;
+			if (food->active && !food->eaten)
+			{
+				Vec2 food_pos = get_cell_pos(game, food->pos);
+				draw_circle(backbuffer, 0.5*food_size, food_pos.x, food_pos.y, palette.food);
+			}
+		}
+	}
+
+	// drawing the snake parts.
+	for (s32 si=0; si < game->snake_part_count; si++)
+	{
+		SnakePart* part = game->snake + si;
+
 		// checking for a full belly
 		float belly_full = 0;
 		for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
@@ -572,34 +851,20 @@ void game_tick(Pixmap* backbuffer, Game* game, Input* input, float dt)
 			Food* food = game->food_list + fi;
 			if (food->active && food->eaten)
 			{
-				if (is_grid_pos_equal(food->pos, part->from_pos))
-				{
-					belly_full = 1.0 - part->pos_t;
-				}
-				else if (is_grid_pos_equal(food->pos, part->to_pos))
-				{
-					belly_full = part->pos_t;
-				}
-				if ((si == game->snake_part_count -1) && belly_full == 1.0f)
-				{
-					grow_snake(game, part->from_pos);
-					food->eaten = false;
-					food->active = false;
-				}
+				float food_belly_full = get_belly_full(food, part);
+				if (food_belly_full > 0) belly_full = food_belly_full;
 			}
 		}
 
 		float part_size = (0.72*game->cell_size) + belly_full * 15;
-		if (!game->game_over) part->pos_t += (speed_mod * 6.8f) * dt;
-		
-		Color part_color = snake_color_1;
-		if (si == 0) part_color = snake_color_0;
+
+		u32 part_color = palette.snake_body;
+		if (si == 0) part_color = palette.snake_head;
 		if (game->game_over)
 		{
 			// making the snake oscillate color.
-			float value = sin((4*M_PI) * game->time_count);
-			value = (value + 1.0)/2.0; // mapping -1/1 to 0/1
-			part_color = color_lerp(make_color(1, 1, 0, 1), value, part_color);
+			part_color = palette.game_over_snake_body;
+			if (si == 0) part_color = palette.game_over_snake_head;
 		}
 
 		// outside the screen check.
@@ -662,119 +927,1078 @@ void game_tick(Pixmap* backbuffer, Game* game, Input* input, float dt)
 			draw_circle(backbuffer, 0.5*part_size, pos.x, pos.y, part_color);
 		}
 	}
-	if (game->game_over)
-	{
-		game->restart_timer -= dt;
-		if (game->restart_timer < 0) game->initialized = false;
-	}
+	return true;
 }
 
 //
-// SDL part
+// Telemetry procs
 //
-int main()
+#if TELEMETRY_MODE
+typedef struct
 {
-	SDL_Init(SDL_INIT_TIMER| SDL_INIT_VIDEO| SDL_INIT_EVENTS);
-	SDL_Window* window = SDL_CreateWindow("Smoking Snake", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
-			WINDOW_WIDTH, WINDOW_HEIGHT, 0);
-	if (window)
-	{
-		// creating the default sdl window surface.
-		SDL_Surface* surface = SDL_GetWindowSurface(window);
-		Pixmap sdl_pixmap;
-		sdl_pixmap.pixels = surface->pixels;
-		sdl_pixmap.pitch = surface->pitch;
-		sdl_pixmap.ro_alpha = true;
-		sdl_pixmap.width = surface->w;
-		sdl_pixmap.height = surface->h;
-		Pixmap* backbuffer = &sdl_pixmap;
+	char name[TELEMETRY_NAME_SIZE];
+	TelemetryCounters* counters; // null if telemetry_open failed.
+}Telemetry;
 
-		// setup time.
-		u32 time_last_frame = 0;
-		u32 frame_time = 16; // 60fps
-		float delta_time = 1.0/60.0; // @todo this will only work in 16ms.
-
-		// get some game memory.
-		Game* game = malloc(sizeof(Game));
-		game->initialized = false;
+void telemetry_open(Telemetry* telemetry)
+{
+	telemetry->counters = 0;
+	snprintf(telemetry->name, TELEMETRY_NAME_SIZE, TELEMETRY_NAME_FORMAT, (s32)getpid());
 
-		Input input = {};
+	s32 fd = shm_open(telemetry->name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		printf("] Cant create the telemetry segment %s.\n", telemetry->name);
+		return;
+	}
+	if (ftruncate(fd, sizeof(TelemetryCounters)) == 0)
+	{
+		void* memory = mmap(0, sizeof(TelemetryCounters), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (memory != MAP_FAILED) telemetry->counters = memory;
+	}
+	close(fd);
 
-		b32 is_running = true;
-		float print_frame_rate_counter = 0;
-		while (is_running)
-		{
-			//
+	if (telemetry->counters)
+	{
+		// ftruncate gives us zeroed memory, only the header needs to be set.
+		telemetry->counters->version = TELEMETRY_VERSION;
+		telemetry->counters->pid = (u32)getpid();
+		__atomic_store_n(&telemetry->counters->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+		printf("] Telemetry at %s.\n", telemetry->name);
+	}
+	else
+	{
+		shm_unlink(telemetry->name);
+		printf("] Cant map the telemetry segment %s.\n", telemetry->name);
+	}
+}
+
+// @note the game is the only writer so there is no lock, just the seqlock counter to let readers detect torn copies.
+// work_us and sleep_us come from SDL_GetPerformanceCounter, SDL_GetTicks64 is too coarse for a sub ms frame.
+void telemetry_publish(Telemetry* telemetry, Game* game, u32 work_us, u32 sleep_us, b32 skipped_frame,
+		b32 game_over_event, b32 restart_event)
+{
+	TelemetryCounters* counters = telemetry->counters;
+	if (!counters) return;
+
+	u32 active_food_count = 0;
+	for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+	{
+		if (game->food_list[fi].active) active_food_count++;
+	}
+
+	__atomic_store_n(&counters->sequence, counters->sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	counters->frame_index++;
+	counters->work_us = work_us;
+	counters->sleep_us = sleep_us;
+	counters->frame_us = work_us + sleep_us;
+	if (work_us > counters->max_work_us) counters->max_work_us = work_us;
+	counters->snake_length = game->snake_part_count;
+	counters->active_food_count = active_food_count;
+	counters->input_queue_depth = game->input_queue_count;
+	counters->game_over = game->game_over;
+	if (game_over_event) counters->game_over_count++;
+	if (restart_event) counters->restart_count++;
+	if (skipped_frame) counters->skipped_frame_count++;
+
+	__atomic_store_n(&counters->sequence, counters->sequence + 1, __ATOMIC_RELEASE);
+}
+
+void telemetry_close(Telemetry* telemetry)
+{
+	if (!telemetry->counters) return;
+	munmap(telemetry->counters, sizeof(TelemetryCounters));
+	shm_unlink(telemetry->name);
+	telemetry->counters = 0;
+}
+#endif
+
+//
+// Spectator procs
+//
+#if SPECTATOR_MODE
+// The game publishes its state as per tick deltas, spectators rebuild a Game from them and render it by themselves.
+// Each tick is sent as one packet: a u16 payload size followed by the messages below.
+#define SPECTATOR_SOCKET_FORMAT "/tmp/smoking_snake.%d.sock"
+#define MAX_SPECTATORS 16
+#define MAX_SPECTATOR_RECONNECTS 5 // reconnects in a row without getting a keyframe before the spectator gives up.
+#define KEYFRAME_INTERVAL 300 // in ticks, a full state every 5 seconds for spectators that got out of sync.
+#define MAX_STREAM_PACKET (2 + 6 + MAX_SNAKE_PARTS*4 + MAX_FOOD_COUNT*3)
+enum
+{
+	Stream_None,
+	Stream_Keyframe,   // u16 part count, u8 pos_t, u8 game over, parts (s8 from x/y, s8 to x/y), food slots (u8 flags, s8 x/y).
+	Stream_Tick,       // u8 pos_t.
+	Stream_HeadMove,   // s8 x/y of the new head target, the rest of the body follows and the tail is dropped.
+	Stream_Grow,       // a new part at the tail, so the tail drop of the last head move is undone.
+	Stream_FoodSpawn,  // u8 slot, s8 x/y.
+	Stream_FoodEat,    // u8 slot.
+	Stream_FoodRemove, // u8 slot.
+	Stream_GameOver,
+	Stream_Reject,     // sent alone to a connection the game refused (too many spectators), it is closed right after.
+};
+enum
+{
+	StreamFood_Active = 1,
+	StreamFood_Eaten = 2,
+};
+
+// pos_t is 0-1 but can overshoot a bit before the next step, so it goes in a u8 with a 0-2 range.
+u32 pack_pos_t(float pos_t)
+{
+	float value = pos_t*127.5f + 0.5f;
+	if (value < 0) value = 0;
+	if (value > 255) value = 255;
+	return (u32)value;
+}
+float unpack_pos_t(u32 value) {return (float)value / 127.5f;}
+
+void put_u8(u8* packet, u32* size, u32 value)
+{
+	ASSERT(*size < MAX_STREAM_PACKET);
+	packet[(*size)++] = (u8)value;
+}
+void put_grid_pos(u8* packet, u32* size, GridPos pos)
+{
+	put_u8(packet, size, (u8)(s8)pos.x);
+	put_u8(packet, size, (u8)(s8)pos.y);
+}
+GridPos get_grid_pos(u8* data) {return grid_pos((s8)data[0], (s8)data[1]);}
+
+// the part of the game state the last packet described, the next delta is the difference to it.
+typedef struct
+{
+	b32 valid;
+	b32 game_over;
+	u32 snake_part_count;
+	GridPos head_to_pos;
+	Food food_list[MAX_FOOD_COUNT];
+}StreamShadow;
+
+typedef struct
+{
+	s32 fd;
+	b32 needs_keyframe;
+}Spectator;
+
+typedef struct
+{
+	s32 listen_fd; // -1 if spectator_stream_open failed.
+	char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+	u32 tick_index;
+
+	u32 spectator_count;
+	Spectator spectators[MAX_SPECTATORS];
+
+	StreamShadow shadow;
+	u32 delta_size;
+	u8 delta[MAX_STREAM_PACKET];
+	u32 keyframe_size;
+	u8 keyframe[MAX_STREAM_PACKET];
+}SpectatorStream;
+
+b32 set_non_blocking(s32 fd)
+{
+	s32 flags = fcntl(fd, F_GETFL, 0);
+	b32 result = flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+	return result;
+}
+
+void spectator_stream_open(SpectatorStream* stream)
+{
+	stream->tick_index = 0;
+	stream->spectator_count = 0;
+	stream->shadow.valid = false;
+	snprintf(stream->path, sizeof(stream->path), SPECTATOR_SOCKET_FORMAT, (s32)getpid());
+
+	// a spectator that goes away in the middle of a send must not kill the game.
+	signal(SIGPIPE, SIG_IGN);
+
+	struct sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, stream->path, sizeof(stream->path));
+	unlink(stream->path);
+
+	stream->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (stream->listen_fd >= 0 &&
+			set_non_blocking(stream->listen_fd) &&
+			bind(stream->listen_fd, (struct sockaddr*)&address, sizeof(address)) == 0 &&
+			listen(stream->listen_fd, MAX_SPECTATORS) == 0)
+	{
+		printf("] Spectators can watch at %s.\n", stream->path);
+	}
+	else
+	{
+		printf("] Cant create the spectator socket %s.\n", stream->path);
+		if (stream->listen_fd >= 0) close(stream->listen_fd);
+		stream->listen_fd = -1;
+	}
+}
+
+void remove_spectator(SpectatorStream* stream, u32 index)
+{
+	close(stream->spectators[index].fd);
+	stream->spectators[index] = stream->spectators[--stream->spectator_count];
+}
+
+void begin_stream_packet(u32* size) {*size = 2;}
+void end_stream_packet(u8* packet, u32 size)
+{
+	u32 payload_size = size - 2;
+	packet[0] = (u8)(payload_size & 0xff);
+	packet[1] = (u8)(payload_size >> 8);
+}
+
+void build_keyframe(SpectatorStream* stream, Game* game)
+{
+	u8* packet = stream->keyframe;
+	u32* size = &stream->keyframe_size;
+	begin_stream_packet(size);
+	put_u8(packet, size, Stream_Keyframe);
+	put_u8(packet, size, game->snake_part_count & 0xff);
+	put_u8(packet, size, game->snake_part_count >> 8);
+	put_u8(packet, size, pack_pos_t(game->snake[0].pos_t));
+	put_u8(packet, size, game->game_over);
+	for (s32 si=0; si < game->snake_part_count; si++)
+	{
+		put_grid_pos(packet, size, game->snake[si].from_pos);
+		put_grid_pos(packet, size, game->snake[si].to_pos);
+	}
+	for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+	{
+		Food* food = game->food_list + fi;
+		u32 flags = 0;
+		if (food->active) flags |= StreamFood_Active;
+		if (food->eaten) flags |= StreamFood_Eaten;
+		put_u8(packet, size, flags);
+		put_grid_pos(packet, size, food->pos);
+	}
+	end_stream_packet(packet, *size);
+}
+
+// returns false when the change since the shadow can't be described by a delta (restart, first tick).
+b32 build_delta(SpectatorStream* stream, Game* game)
+{
+	StreamShadow* shadow = &stream->shadow;
+	if (!shadow->valid) return false;
+	if (game->snake_part_count < shadow->snake_part_count) return false;
+	if (shadow->game_over && !game->game_over) return false;
+
+	u8* packet = stream->delta;
+	u32* size = &stream->delta_size;
+	begin_stream_packet(size);
+	put_u8(packet, size, Stream_Tick);
+	put_u8(packet, size, pack_pos_t(game->snake[0].pos_t));
+
+	if (!is_grid_pos_equal(shadow->head_to_pos, game->snake[0].to_pos))
+	{
+		put_u8(packet, size, Stream_HeadMove);
+		put_grid_pos(packet, size, game->snake[0].to_pos);
+	}
+	for (u32 count=shadow->snake_part_count; count < game->snake_part_count; count++)
+	{
+		put_u8(packet, size, Stream_Grow);
+	}
+	for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+	{
+		Food* before = shadow->food_list + fi;
+		Food* food = game->food_list + fi;
+		if (food->active)
+		{
+			// a slot can be freed and spawned again in the same tick.
+			b32 was_eaten = before->eaten;
+			if (!before->active || !is_grid_pos_equal(before->pos, food->pos) || (before->eaten && !food->eaten))
+			{
+				put_u8(packet, size, Stream_FoodSpawn);
+				put_u8(packet, size, fi);
+				put_grid_pos(packet, size, food->pos);
+				was_eaten = false;
+			}
+			if (food->eaten && !was_eaten)
+			{
+				put_u8(packet, size, Stream_FoodEat);
+				put_u8(packet, size, fi);
+			}
+		}
+		else if (before->active)
+		{
+			put_u8(packet, size, Stream_FoodRemove);
+			put_u8(packet, size, fi);
+		}
+	}
+	if (game->game_over && !shadow->game_over) put_u8(packet, size, Stream_GameOver);
+	end_stream_packet(packet, *size);
+	return true;
+}
+
+b32 send_stream_packet(s32 fd, u8* packet, u32 size)
+{
+	// @note a short write would leave the spectator with half a packet, so it is treated as a failure too.
+	ssize_t sent = send(fd, packet, size, 0);
+	b32 result = sent == (ssize_t)size;
+	return result;
+}
+
+void spectator_stream_publish(SpectatorStream* stream, Game* game)
+{
+	if (stream->listen_fd < 0) return;
+	stream->tick_index++;
+
+	// accepting the new spectators, they start with a keyframe.
+	for (;;)
+	{
+		s32 fd = accept(stream->listen_fd, 0, 0);
+		if (fd < 0) break;
+		if (stream->spectator_count < MAX_SPECTATORS && set_non_blocking(fd))
+		{
+			Spectator* spectator = stream->spectators + stream->spectator_count++;
+			spectator->fd = fd;
+			spectator->needs_keyframe = true;
+		}
+		else
+		{
+			// telling the spectator why, so it stops instead of connecting again.
+			u8 reject[3] = {1, 0, Stream_Reject};
+			send_stream_packet(fd, reject, sizeof(reject));
+			close(fd);
+		}
+	}
+
+	if (stream->spectator_count == 0)
+	{
+		stream->shadow.valid = false;
+		return;
+	}
+
+	b32 keyframe_for_all = (stream->tick_index % KEYFRAME_INTERVAL) == 0;
+	if (!keyframe_for_all) keyframe_for_all = !build_delta(stream, game);
+
+	b32 keyframe_built = false;
+	for (u32 index=0; index < stream->spectator_count;)
+	{
+		Spectator* spectator = stream->spectators + index;
+		b32 sent;
+		if (keyframe_for_all || spectator->needs_keyframe)
+		{
+			if (!keyframe_built)
+			{
+				build_keyframe(stream, game);
+				keyframe_built = true;
+			}
+			sent = send_stream_packet(spectator->fd, stream->keyframe, stream->keyframe_size);
+			spectator->needs_keyframe = false;
+		}
+		else sent = send_stream_packet(spectator->fd, stream->delta, stream->delta_size);
+
+		// a spectator that can't keep up is dropped instead of making the game wait, it reconnects and gets a keyframe.
+		if (sent) index++;
+		else remove_spectator(stream, index);
+	}
+
+	StreamShadow* shadow = &stream->shadow;
+	shadow->valid = true;
+	shadow->game_over = game->game_over;
+	shadow->snake_part_count = game->snake_part_count;
+	shadow->head_to_pos = game->snake[0].to_pos;
+	memcpy(shadow->food_list, game->food_list, sizeof(shadow->food_list));
+}
+
+void spectator_stream_close(SpectatorStream* stream)
+{
+	if (stream->listen_fd < 0) return;
+	while (stream->spectator_count) remove_spectator(stream, 0);
+	close(stream->listen_fd);
+	unlink(stream->path);
+	stream->listen_fd = -1;
+}
+
+// the spectator side.
+typedef struct
+{
+	s32 pid;
+	s32 fd;
+	b32 synced; // a keyframe was applied since the last connect.
+	b32 rejected; // the game refused the connection.
+	u32 reconnect_count; // reconnects in a row that didn't bring a keyframe yet.
+	u32 buffer_size;
+	u8 buffer[2*MAX_STREAM_PACKET];
+}SpectatorClient;
+
+// the game sends a keyframe to every new connection, so this is also how a dropped spectator gets back in sync.
+b32 spectator_client_connect(SpectatorClient* client)
+{
+	client->buffer_size = 0;
+	client->synced = false;
+	client->rejected = false;
+
+	struct sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	snprintf(address.sun_path, sizeof(address.sun_path), SPECTATOR_SOCKET_FORMAT, client->pid);
+
+	client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (client->fd >= 0 &&
+			connect(client->fd, (struct sockaddr*)&address, sizeof(address)) == 0 &&
+			set_non_blocking(client->fd))
+	{
+		return true;
+	}
+	if (client->fd >= 0) close(client->fd);
+	client->fd = -1;
+	return false;
+}
+
+b32 spectator_client_open(SpectatorClient* client, Game* game, s32 pid)
+{
+	memset(game, 0, sizeof(Game));
+	game->initialized = true;
+	setup_grid(game);
+
+	client->pid = pid;
+	client->reconnect_count = 0;
+	b32 result = spectator_client_connect(client);
+	if (!result) printf("] Cant connect to the game %d.\n", pid);
+	return result;
+}
+
+// the payload size of a message (see the Stream_ enum), -1 if the payload is not all in the available bytes.
+s32 get_stream_payload_size(u32 type, u8* data, u32 available)
+{
+	s32 result = 0;
+	switch (type)
+	{
+		case Stream_Keyframe:
+		{
+			if (available < 2) return -1;
+			u32 snake_part_count = data[0] | (data[1] << 8);
+			if (snake_part_count > MAX_SNAKE_PARTS) return -1;
+			result = 4 + snake_part_count*4 + MAX_FOOD_COUNT*3;
+		}break;
+		case Stream_Tick: result = 1; break;
+		case Stream_HeadMove: result = 2; break;
+		case Stream_FoodSpawn: result = 3; break;
+		case Stream_FoodEat: result = 1; break;
+		case Stream_FoodRemove: result = 1; break;
+	}
+	if (result > (s32)available) result = -1;
+	return result;
+}
+
+void apply_stream_packet(SpectatorClient* client, Game* game, u8* data, u32 size)
+{
+	u8* end = data + size;
+	while (data < end)
+	{
+		u32 type = *data++;
+		s32 payload_size = get_stream_payload_size(type, data, (u32)(end - data));
+		if (payload_size < 0)
+		{
+			// the rest of the packet can't be trusted, the next keyframe puts the spectator back in sync.
+			printf("] Broken stream message %u.\n", type);
+			return;
+		}
+		switch (type)
+		{
+			case Stream_Keyframe:
+			{
+				game->snake_part_count = data[0] | (data[1] << 8);
+				float pos_t = unpack_pos_t(data[2]);
+				game->game_over = data[3];
+				data += 4;
+				for (s32 si=0; si < game->snake_part_count; si++)
+				{
+					SnakePart* part = game->snake + si;
+					part->from_pos = get_grid_pos(data);
+					part->to_pos = get_grid_pos(data + 2);
+					part->pos_t = pos_t;
+					data += 4;
+				}
+				for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+				{
+					Food* food = game->food_list + fi;
+					food->active = (data[0] & StreamFood_Active) != 0;
+					food->eaten = (data[0] & StreamFood_Eaten) != 0;
+					food->pos = get_grid_pos(data + 1);
+					data += 3;
+				}
+				client->synced = true;
+			}break;
+			case Stream_Tick:
+			{
+				float pos_t = unpack_pos_t(*data++);
+				for (s32 si=0; si < game->snake_part_count; si++) game->snake[si].pos_t = pos_t;
+			}break;
+			case Stream_HeadMove:
+			{
+				// the same step the game does, every part moves to where the one in front of it was.
+				for (s32 si=0; si < game->snake_part_count; si++)
+				{
+					SnakePart* part = game->snake + si;
+					part->from_pos = part->to_pos;
+					if (si > 0) part->to_pos = game->snake[si-1].from_pos;
+				}
+				game->snake[0].to_pos = get_grid_pos(data);
+				data += 2;
+			}break;
+			case Stream_Grow:
+			{
+				if (game->snake_part_count > 0 && game->snake_part_count < MAX_SNAKE_PARTS)
+				{
+					SnakePart* tail = game->snake + game->snake_part_count-1;
+					SnakePart* part = grow_snake(game, tail->from_pos);
+					part->pos_t = tail->pos_t;
+				}
+			}break;
+			case Stream_FoodSpawn:
+			{
+				Food* food = game->food_list + (data[0] % MAX_FOOD_COUNT);
+				food->active = true;
+				food->eaten = false;
+				food->pos = get_grid_pos(data + 1);
+				data += 3;
+			}break;
+			case Stream_FoodEat: game->food_list[*data++ % MAX_FOOD_COUNT].eaten = true; break;
+			case Stream_FoodRemove: game->food_list[*data++ % MAX_FOOD_COUNT].active = false; break;
+			case Stream_GameOver: game->game_over = true; break;
+			case Stream_Reject: client->rejected = true; break;
+			default:
+			{
+				printf("] Unknown stream message %u.\n", type);
+				return;
+			}
+		}
+	}
+}
+
+// applies every complete packet that arrived, returns false when the connection was closed, either because the game
+// quit or because it dropped this spectator for being too slow.
+b32 spectator_client_receive(SpectatorClient* client, Game* game)
+{
+	if (client->fd < 0) return false;
+	b32 result = true;
+	for (;;)
+	{
+		ssize_t received = recv(client->fd, client->buffer + client->buffer_size,
+				sizeof(client->buffer) - client->buffer_size, 0);
+		if (received > 0) client->buffer_size += received;
+		else
+		{
+			if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) result = false;
+			break;
+		}
+
+		u32 offset = 0;
+		while (client->buffer_size - offset >= 2)
+		{
+			u32 payload_size = client->buffer[offset] | (client->buffer[offset+1] << 8);
+			if (client->buffer_size - offset - 2 < payload_size) break;
+			apply_stream_packet(client, game, client->buffer + offset + 2, payload_size);
+			offset += 2 + payload_size;
+		}
+		memmove(client->buffer, client->buffer + offset, client->buffer_size - offset);
+		client->buffer_size -= offset;
+	}
+	if (client->synced && client->reconnect_count)
+	{
+		printf("] Reconnected to the game.\n");
+		client->reconnect_count = 0;
+	}
+	return result;
+}
+
+void spectator_client_close(SpectatorClient* client)
+{
+	if (client->fd >= 0) close(client->fd);
+	client->fd = -1;
+}
+
+// called when spectator_client_receive lost the connection, returns false if the spectator should stop.
+// if the game is still there we were just dropped, connecting again brings a new keyframe.
+b32 spectator_client_reconnect(SpectatorClient* client)
+{
+	spectator_client_close(client);
+	b32 result = false;
+	if (client->rejected) printf("] The game has too many spectators, stopping.\n");
+	else if (client->reconnect_count >= MAX_SPECTATOR_RECONNECTS) printf("] Cant get in sync with the game, stopping.\n");
+	else if (!spectator_client_connect(client)) printf("] The game is gone, stopping.\n");
+	else
+	{
+		client->reconnect_count++;
+		result = true;
+	}
+	return result;
+}
+#endif
+
+//
+// Stress test procs
+//
+// "--stress [file.csv]" synthesizes game states, runs the tick and the rasterizer headless on them and writes how the
+// frame time grows with the snake length, the food count and the mirrored edges as CSV (stdout by default).
+#define STRESS_ITERATIONS 200
+#define STRESS_WARMUP_ITERATIONS 20 // not measured, they just get the caches and the branch predictor going.
+#define STRESS_STEP_PHASES 8 // one in this many iterations starts at pos_t 1 and takes the step to the next cell.
+typedef struct
+{
+	float fill; // how much of the board the snake covers, 0-1.
+	u32 food_count;
+	b32 on_edge; // the snake zig-zags across the mirrored edges first, so its parts take the draw twice path.
+}Scenario;
+
+// the board walked row by row in alternating directions.
+// when on_edge the walk first zig-zags between the first and the last column, so every other part wraps around the
+// left/right edge, then the same between the first and the last row with the columns left, and then it walks the
+// rest of the board. @note only the border cells can be mirrored, so past about 2*2*CELL_COUNT parts the snake
+// goes on in the middle of the board.
+GridPos get_scenario_cell(u32 index, b32 on_edge)
+{
+	s32 last = CELL_COUNT-1;
+	s32 row;
+	s32 column;
+	if (!on_edge)
+	{
+		row = index / CELL_COUNT;
+		column = index % CELL_COUNT;
+		if (row & 1) column = last - column;
+	}
+	else if (index < 2*CELL_COUNT)
+	{
+		// (last, 0) (0, 0) (0, 1) (last, 1) (last, 2) ...
+		row = index / 2;
+		column = ((index + row) & 1) ? 0 : last;
+	}
+	else if (index < 2*CELL_COUNT + 2*(CELL_COUNT-2))
+	{
+		// from (0, last): (1, last) (1, 0) (2, 0) (2, last) ...
+		u32 edge_index = index - 2*CELL_COUNT;
+		column = 1 + edge_index / 2;
+		row = ((edge_index + column) & 1) ? last : 0;
+	}
+	else
+	{
+		// from (last-1, 0) the inner cells, row by row starting to the left.
+		u32 inner_count = CELL_COUNT-2;
+		u32 inner_index = index - (2*CELL_COUNT + 2*inner_count);
+		row = 1 + inner_index / inner_count;
+		column = inner_index % inner_count;
+		if (!(row & 1)) column = inner_count-1 - column;
+		column = 1 + (inner_count-1 - column);
+	}
+	GridPos result = grid_pos(column - HALF_CELL_COUNT, row - HALF_CELL_COUNT);
+	return result;
+}
+
+b32 is_part_on_mirror(SnakePart* part)
+{
+	s32 h_value = part->to_pos.x - part->from_pos.x;
+	s32 v_value = part->to_pos.y - part->from_pos.y;
+	b32 result = h_value < -1 || h_value > 1 || v_value < -1 || v_value > 1;
+	return result;
+}
+
+void load_scenario(Game* game, Scenario scenario)
+{
+	u32 cell_count = CELL_COUNT*CELL_COUNT;
+	u32 snake_part_count = (u32)(scenario.fill * cell_count);
+	if (snake_part_count < 2) snake_part_count = 2;
+	if (snake_part_count > MAX_SNAKE_PARTS-1) snake_part_count = MAX_SNAKE_PARTS-1; // the head needs a free cell.
+
+	game->initialized = true;
+	setup_grid(game);
+	game->game_over = false;
+	game->restart_timer = 0;
+	game->time_count = 0.3f;
+	game->input_queue_count = 0;
+	game->food_spawn_timer = 3; // nothing spawns in the middle of a measurement.
+
+	// the head is the last cell of the walk and is about to move to the next one, the rest of the body follows.
+	game->snake_part_count = 0;
+	for (u32 si=0; si < snake_part_count; si++)
+	{
+		SnakePart* part = grow_snake(game, get_scenario_cell(snake_part_count-1 - si, scenario.on_edge));
+		part->to_pos = get_scenario_cell(snake_part_count - si, scenario.on_edge);
+		part->pos_t = 0.5f;
+	}
+	// the head keeps following the walk when it steps, so it moves into a free cell instead of its own body.
+	GridPos to = get_scenario_cell(snake_part_count, scenario.on_edge);
+	GridPos next = get_scenario_cell(snake_part_count+1, scenario.on_edge);
+	GridPos dir = grid_pos(next.x - to.x, next.y - to.y);
+	if (dir.x > 1) dir.x = -1; // wrapping around the mirrored edges.
+	if (dir.x < -1) dir.x = 1;
+	if (dir.y > 1) dir.y = -1;
+	if (dir.y < -1) dir.y = 1;
+	game->snake_dir = dir;
+
+	// the food goes in the free cells after the head, spread along the rest of the walk.
+	for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+	{
+		Food* food = game->food_list + fi;
+		food->active = false;
+		food->eaten = false;
+		food->timer = 30;
+		food->pos = grid_pos(0, 0);
+	}
+	u32 free_cell_count = cell_count - snake_part_count - 1;
+	u32 food_count = scenario.food_count;
+	if (food_count > MAX_FOOD_COUNT) food_count = MAX_FOOD_COUNT;
+	if (food_count > free_cell_count) food_count = free_cell_count;
+	for (u32 fi=0; fi < food_count; fi++)
+	{
+		Food* food = game->food_list + fi;
+		food->active = true;
+		food->pos = get_scenario_cell(snake_part_count+1 + (fi * free_cell_count) / food_count, scenario.on_edge);
+	}
+}
+
+int compare_samples(const void* a, const void* b)
+{
+	double sample_a = *(double*)a;
+	double sample_b = *(double*)b;
+	return (sample_a > sample_b) - (sample_a < sample_b);
+}
+
+// sorts the samples in place.
+double get_median(double* samples, u32 count)
+{
+	qsort(samples, count, sizeof(double), compare_samples);
+	double result = samples[count/2];
+	if ((count & 1) == 0) result = (samples[count/2 - 1] + samples[count/2]) / 2.0;
+	return result;
+}
+
+void run_scenario(FILE* file, char* sweep, Scenario scenario, Game* scenario_game, Game* game, Pixmap* pixmap)
+{
+	load_scenario(scenario_game, scenario);
+	Input input = {};
+	float delta_time = 1.0/60.0;
+	double ticks_to_us = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+
+	double update_samples[STRESS_ITERATIONS];
+	double render_samples[STRESS_ITERATIONS];
+	double update_total = 0, update_min = 1e30;
+	double render_total = 0, render_min = 1e30;
+	for (s32 iteration=-STRESS_WARMUP_ITERATIONS; iteration < STRESS_ITERATIONS; iteration++)
+	{
+		// every iteration starts from the same state, the copy is not measured.
+		// the parts are spread along the move to the next cell like in a real game, so the ticks that step to
+		// the next cell (and check the food and the collisions against the new cell) are measured too.
+		memcpy(game, scenario_game, sizeof(Game));
+		s32 phase = (iteration + STRESS_WARMUP_ITERATIONS) % STRESS_STEP_PHASES;
+		float pos_t = (float)(phase + 1) / STRESS_STEP_PHASES;
+		for (s32 si=0; si < game->snake_part_count; si++) game->snake[si].pos_t = pos_t;
+
+		u64 begin = SDL_GetPerformanceCounter();
+		game_update(game, &input, delta_time);
+		u64 updated = SDL_GetPerformanceCounter();
+		game_render(pixmap, game, 0);
+		u64 rendered = SDL_GetPerformanceCounter();
+		if (iteration < 0) continue;
+
+		double update_time = (double)(updated - begin) * ticks_to_us;
+		double render_time = (double)(rendered - updated) * ticks_to_us;
+		update_samples[iteration] = update_time;
+		render_samples[iteration] = render_time;
+		update_total += update_time;
+		render_total += render_time;
+		if (update_time < update_min) update_min = update_time;
+		if (render_time < render_min) render_min = render_time;
+	}
+	double update_median = get_median(update_samples, STRESS_ITERATIONS);
+	double render_median = get_median(render_samples, STRESS_ITERATIONS);
+
+	u32 active_food_count = 0;
+	for (s32 fi=0; fi < MAX_FOOD_COUNT; fi++)
+	{
+		if (scenario_game->food_list[fi].active) active_food_count++;
+	}
+	u32 mirrored_part_count = 0;
+	for (s32 si=0; si < scenario_game->snake_part_count; si++)
+	{
+		if (is_part_on_mirror(scenario_game->snake + si)) mirrored_part_count++;
+	}
+	fprintf(file, "%s,%.2f,%u,%u,%u,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", sweep, scenario.fill,
+			scenario_game->snake_part_count, active_food_count, scenario.on_edge, mirrored_part_count,
+			update_total / STRESS_ITERATIONS, update_median, update_min,
+			render_total / STRESS_ITERATIONS, render_median, render_min);
+}
+
+s32 run_stress_test(char* csv_path)
+{
+	FILE* file = stdout;
+	if (csv_path)
+	{
+		file = fopen(csv_path, "w");
+		if (!file)
+		{
+			printf("] Cant open %s.\n", csv_path);
+			return 1;
+		}
+	}
+
+	init_color_tables();
+	Pixmap pixmap;
+	pixmap.width = WINDOW_WIDTH;
+	pixmap.height = WINDOW_HEIGHT;
+	pixmap.kernels = &xrgb8888_kernels;
+	pixmap.pitch = WINDOW_WIDTH * pixmap.kernels->bytes_per_pixel;
+	pixmap.pixels = malloc(pixmap.pitch * WINDOW_HEIGHT);
+	Game* scenario_game = malloc(sizeof(Game));
+	Game* game = malloc(sizeof(Game));
+
+	fprintf(file, "sweep,fill,snake_length,food_count,on_edge,mirrored_parts,update_us,update_median_us,update_min_us,render_us,render_median_us,render_min_us\n");
+	for (s32 step=0; step <= 10; step++)
+	{
+		Scenario scenario = {0.1f * step, 1, false};
+		run_scenario(file, "snake_length", scenario, scenario_game, game, &pixmap);
+	}
+	for (s32 step=0; step <= 10; step++)
+	{
+		Scenario scenario = {0.1f * step, 1, true};
+		run_scenario(file, "snake_length_on_edge", scenario, scenario_game, game, &pixmap);
+	}
+	for (u32 food_count=0; food_count <= MAX_FOOD_COUNT; food_count++)
+	{
+		Scenario scenario = {0.1f, food_count, false};
+		run_scenario(file, "food_count", scenario, scenario_game, game, &pixmap);
+	}
+
+	if (file != stdout) fclose(file);
+	free(pixmap.pixels);
+	free(scenario_game);
+	free(game);
+	return 0;
+}
+
+//
+// SDL part
+//
+typedef struct
+{
+	b32 is_running;
+	b32 is_visible; // false when the window is minimized or hidden, there is no point in drawing then.
+	b32 needs_redraw; // the window contents were lost (exposed, restored).
+}WindowState;
+
+void handle_event(SDL_Event* event, Input* input, WindowState* window_state)
+{
+	switch (event->type)
+	{
+		case SDL_QUIT:
+			window_state->is_running = false;
+			printf("] Quitting the game...\n");
+		break;
+		case SDL_WINDOWEVENT:
+		{
+			switch (event->window.event)
+			{
+				case SDL_WINDOWEVENT_HIDDEN:
+				case SDL_WINDOWEVENT_MINIMIZED: window_state->is_visible = false; break;
+				case SDL_WINDOWEVENT_SHOWN:
+				case SDL_WINDOWEVENT_RESTORED:
+				case SDL_WINDOWEVENT_MAXIMIZED:
+				case SDL_WINDOWEVENT_EXPOSED:
+				{
+					window_state->is_visible = true;
+					window_state->needs_redraw = true;
+				}break;
+			}
+		}break;
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+		{
+			b32 is_key_down = event->key.type == SDL_KEYDOWN;
+			SDL_Keycode keycode = event->key.keysym.sym;
+			if (!event->key.repeat)
+			{
+				if (is_key_down)
+				{
+					switch (keycode) 
+					{
+						case SDLK_w: change_key(&input->up, 1); break;
+						case SDLK_s: change_key(&input->down, 1); break;
+						case SDLK_a: change_key(&input->left, 1); break;
+						case SDLK_d: change_key(&input->right, 1); break;
+
+						case SDLK_UP: change_key(&input->up, 1); break;
+						case SDLK_DOWN: change_key(&input->down, 1); break;
+						case SDLK_LEFT: change_key(&input->left, 1); break;
+						case SDLK_RIGHT: change_key(&input->right, 1); break;
+					}
+				}
+				else
+				{
+					switch (keycode) 
+					{
+						case SDLK_w: change_key(&input->up, -1); break;
+						case SDLK_s: change_key(&input->down, -1); break;
+						case SDLK_a: change_key(&input->left, -1); break;
+						case SDLK_d: change_key(&input->right, -1); break;
+
+						case SDLK_UP: change_key(&input->up, -1); break;
+						case SDLK_DOWN: change_key(&input->down, -1); break;
+						case SDLK_LEFT: change_key(&input->left, -1); break;
+						case SDLK_RIGHT: change_key(&input->right, -1); break;
+					}
+				}
+			}
+		}break;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--stress") == 0) return run_stress_test(argc > 2 ? argv[2] : 0);
+
+	// "--spectate <pid>" watches the game running in another process instead of playing.
+	s32 spectate_pid = 0;
+#if SPECTATOR_MODE
+	if (argc > 2 && strcmp(argv[1], "--spectate") == 0) spectate_pid = atoi(argv[2]);
+#endif
+
+	SDL_Init(SDL_INIT_TIMER| SDL_INIT_VIDEO| SDL_INIT_EVENTS);
+	SDL_Window* window = SDL_CreateWindow(spectate_pid ? "Smoking Snake (spectator)" : "Smoking Snake",
+			SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, 0);
+	if (window)
+	{
+		// creating the default sdl window surface.
+		SDL_Surface* surface = SDL_GetWindowSurface(window);
+		// if there are no kernels for the window surface format we render into a XRGB8888 surface and let SDL
+		// convert it when blitting to the window.
+		SDL_Surface* render_surface = surface;
+		PixelKernels* kernels = get_pixel_kernels(surface->format->format);
+		if (!kernels)
+		{
+			printf("] No kernels for %s, converting from XRGB8888.\n", SDL_GetPixelFormatName(surface->format->format));
+			render_surface = SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, 32, SDL_PIXELFORMAT_RGB888);
+			kernels = &xrgb8888_kernels;
+			if (!render_surface)
+			{
+				printf("] Cant create a XRGB8888 SDL_Surface.\n");
+				return 0;
+			}
+		}
+		Pixmap sdl_pixmap;
+		sdl_pixmap.pixels = render_surface->pixels;
+		sdl_pixmap.pitch = render_surface->pitch;
+		sdl_pixmap.kernels = kernels;
+		sdl_pixmap.width = render_surface->w;
+		sdl_pixmap.height = render_surface->h;
+		Pixmap* backbuffer = &sdl_pixmap;
+
+		// setup time.
+		u64 time_last_frame = SDL_GetTicks64();
+		u32 frame_time = 16; // 60fps
+		float delta_time = 1.0/60.0; // @todo this will only work in 16ms.
+
+		init_color_tables();
+
+		// get some game memory.
+		Game* game = malloc(sizeof(Game));
+		game->initialized = false;
+
+		Input input = {};
+
+#if SPECTATOR_MODE
+		SpectatorStream* stream = 0;
+		SpectatorClient* client = 0;
+		if (spectate_pid)
+		{
+			client = malloc(sizeof(SpectatorClient));
+			if (!spectator_client_open(client, game, spectate_pid)) return 1;
+		}
+		else
+		{
+			stream = malloc(sizeof(SpectatorStream));
+			spectator_stream_open(stream);
+		}
+#endif
+
+#if TELEMETRY_MODE
+		Telemetry telemetry;
+		telemetry_open(&telemetry);
+		b32 was_game_over = false; // for detecting the game over and restart events.
+		double counter_to_us = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+		u64 frame_begin_counter = SDL_GetPerformanceCounter();
+#endif
+
+		WindowState window_state;
+		window_state.is_running = true;
+		window_state.is_visible = !(SDL_GetWindowFlags(window) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED));
+		window_state.needs_redraw = true;
+		u64 frame_hash = 0;
+
+		float print_frame_rate_counter = 0;
+		while (window_state.is_running)
+		{
+			//
 			// Input
 			//
+			// @note most of the events are handled while waiting for the next frame below, these are the ones
+			// that arrived while working on this frame.
 			SDL_Event event;
-			// cleanup input keys
-			input.left.changed = false;
-			input.right.changed = false;
-			input.up.changed = false;
-			input.down.changed = false;
+			while (SDL_PollEvent(&event)) handle_event(&event, &input, &window_state);
 
-			while (SDL_PollEvent(&event))
+			// while nobody can see the window there is nothing to draw, so we wake up less often and run
+			// HIDDEN_TICKS_PER_WAKE fixed ticks per wake, this keeps the game and the spectators at the same speed.
+			u32 tick_count = window_state.is_visible ? 1 : HIDDEN_TICKS_PER_WAKE;
+#if SPECTATOR_MODE
+			if (client)
 			{
-				switch (event.type)
+				if (!spectator_client_receive(client, game) && !spectator_client_reconnect(client))
 				{
-					case SDL_QUIT:
-						is_running = false;
-						printf("] Quitting the game...\n");
-					break;
-					case SDL_KEYDOWN:
-					case SDL_KEYUP:
-					{
-						b32 is_key_down = event.key.type == SDL_KEYDOWN;
-						SDL_Keycode keycode = event.key.keysym.sym;
-						if (!event.key.repeat)
-						{
-							if (is_key_down)
-							{
-								switch (keycode) 
-								{
-									case SDLK_w: change_key(&input.up, 1); break;
-									case SDLK_s: change_key(&input.down, 1); break;
-									case SDLK_a: change_key(&input.left, 1); break;
-									case SDLK_d: change_key(&input.right, 1); break;
-
-									case SDLK_UP: change_key(&input.up, 1); break;
-									case SDLK_DOWN: change_key(&input.down, 1); break;
-									case SDLK_LEFT: change_key(&input.left, 1); break;
-									case SDLK_RIGHT: change_key(&input.right, 1); break;
-								}
-							}
-							else
-							{
-								switch (keycode) 
-								{
-									case SDLK_w: change_key(&input.up, -1); break;
-									case SDLK_s: change_key(&input.down, -1); break;
-									case SDLK_a: change_key(&input.left, -1); break;
-									case SDLK_d: change_key(&input.right, -1); break;
-
-									case SDLK_UP: change_key(&input.up, -1); break;
-									case SDLK_DOWN: change_key(&input.down, -1); break;
-									case SDLK_LEFT: change_key(&input.left, -1); break;
-									case SDLK_RIGHT: change_key(&input.right, -1); break;
-								}
-							}
-						}
-					}break;
+					window_state.is_running = false;
+				}
+				game->time_count += delta_time * tick_count; // the spectator has its own clock for the animations.
+			}
+			else
+#endif
+			{
+				for (u32 tick=0; tick < tick_count; tick++)
+				{
+					game_update(game, &input, delta_time);
+#if SPECTATOR_MODE
+					spectator_stream_publish(stream, game);
+#endif
+					// cleanup input keys
+					input.left.changed = false;
+					input.right.changed = false;
+					input.up.changed = false;
+					input.down.changed = false;
 				}
 			}
 
-			game_tick(backbuffer, game, &input, delta_time);
-			print_frame_rate_counter += delta_time;
+			// skipping the rasterization and the present when nobody can see it or it would look the same.
+			b32 drawn = false;
+			if (window_state.is_visible)
+			{
+				if (window_state.needs_redraw) frame_hash = 0;
+				window_state.needs_redraw = false;
+				drawn = game_render(backbuffer, game, &frame_hash);
+			}
+			print_frame_rate_counter += delta_time * tick_count;
 
-			// sleep some time to maintain 16ms if needed.
-			u32 work_time = SDL_GetTicks64() - time_last_frame;
+#if TELEMETRY_MODE
+			u64 work_end_counter = SDL_GetPerformanceCounter();
+#endif
+			// sleep some time to maintain 16ms (per tick) if needed.
+			u32 wake_time = frame_time * tick_count;
+			u32 work_time = (u32)(SDL_GetTicks64() - time_last_frame);
 			// if work time is greater than the frame time just dont sleep.
 			u32 sleep_time = 0;
-			if (work_time < frame_time) 
+			if (work_time < wake_time) 
 			{
-				sleep_time = frame_time - work_time;
-				SDL_Delay(sleep_time);
+				sleep_time = wake_time - work_time;
+				// blocking on the events instead of just sleeping, so the input is handled as soon as it arrives.
+				// a hidden window that gets visible again stops waiting right away so it gets drawn.
+				u64 frame_end = SDL_GetTicks64() + sleep_time;
+				b32 was_visible = window_state.is_visible;
+				for (u64 now = SDL_GetTicks64();
+						now < frame_end && window_state.is_running && window_state.is_visible == was_visible;
+						now = SDL_GetTicks64())
+				{
+					if (SDL_WaitEventTimeout(&event, (s32)(frame_end - now))) handle_event(&event, &input, &window_state);
+				}
 			}
 #if DEBUG_MODE
 			// printing the frame rate once per second.
@@ -784,9 +2008,31 @@ int main()
 				printf("] work-frame | %2dms %2dms\n", work_time, work_time + sleep_time);
 			}
 #endif
-			SDL_UpdateWindowSurface(window);
+#if TELEMETRY_MODE
+			u64 sleep_end_counter = SDL_GetPerformanceCounter();
+			telemetry_publish(&telemetry, game, (u32)((work_end_counter - frame_begin_counter) * counter_to_us),
+					(u32)((sleep_end_counter - work_end_counter) * counter_to_us), !drawn,
+					!was_game_over && game->game_over, was_game_over && !game->game_over);
+			was_game_over = game->game_over;
+#endif
+			if (drawn)
+			{
+				if (render_surface != surface) SDL_BlitSurface(render_surface, 0, surface, 0);
+				SDL_UpdateWindowSurface(window);
+			}
 			time_last_frame = SDL_GetTicks64();
+#if TELEMETRY_MODE
+			frame_begin_counter = SDL_GetPerformanceCounter();
+#endif
 		}
+#if TELEMETRY_MODE
+		telemetry_close(&telemetry);
+#endif
+#if SPECTATOR_MODE
+		if (stream) spectator_stream_close(stream);
+		if (client) spectator_client_close(client);
+#endif
+		if (render_surface != surface) SDL_FreeSurface(render_surface);
 	}
 	else printf("] Cant create a SDL_Window.\n");
 	return 0;
@@ -0,0 +1,40 @@
+// Live telemetry counters shared between the game and telemetry_reader through a POSIX shm segment.
+// The game is the only writer, readers just map the segment read only and copy it out.
+// @note the fields use fixed width types since this layout is shared between two processes.
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC 0x544b4e53 // 'SNKT'
+#define TELEMETRY_VERSION 3
+// one segment per game process: "/smoking_snake.<pid>".
+#define TELEMETRY_NAME_FORMAT "/smoking_snake.%d"
+#define TELEMETRY_NAME_SIZE 64
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	// seqlock: odd while the game is writing the counters, a reader must retry if it changed during the copy.
+	uint32_t sequence;
+	uint32_t pid;
+
+	uint64_t frame_index;
+	// times of the last frame in microseconds, a frame is usually well under 1ms of work.
+	uint32_t work_us;
+	uint32_t sleep_us;
+	uint32_t frame_us;
+	uint32_t max_work_us; // worst work time since the game started.
+
+	uint32_t snake_length;
+	uint32_t active_food_count;
+	uint32_t input_queue_depth;
+	uint32_t game_over;
+
+	uint64_t game_over_count;
+	uint64_t restart_count;
+	uint64_t skipped_frame_count; // frames that were not drawn since they were unchanged or not visible.
+}TelemetryCounters;
+
+#endif
@@ -0,0 +1,94 @@
+// Small tool that tails the telemetry counters of a running smoking_snake without pausing it.
+// usage: telemetry_reader <pid> [interval_ms]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+typedef unsigned int b32;
+typedef unsigned int u32;
+typedef int s32;
+#define true 1
+#define false !true
+
+// copies the counters out of the segment, retrying while the game is in the middle of a write.
+b32 read_counters(volatile TelemetryCounters* shared, TelemetryCounters* out)
+{
+	for (s32 attempt=0; attempt < 1000; attempt++)
+	{
+		u32 sequence_begin = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+		if (sequence_begin & 1) continue;
+
+		*out = *(TelemetryCounters*)shared;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		u32 sequence_end = __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED);
+		if (sequence_begin == sequence_end) return true;
+	}
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("usage: %s <pid> [interval_ms]\n", argv[0]);
+		return 1;
+	}
+	s32 pid = atoi(argv[1]);
+	s32 interval_ms = 1000;
+	if (argc > 2) interval_ms = atoi(argv[2]);
+	if (interval_ms <= 0) interval_ms = 1000;
+
+	char name[TELEMETRY_NAME_SIZE];
+	snprintf(name, TELEMETRY_NAME_SIZE, TELEMETRY_NAME_FORMAT, pid);
+	s32 fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		printf("] Cant open the telemetry segment %s, is the game running with TELEMETRY_MODE?\n", name);
+		return 1;
+	}
+	void* memory = mmap(0, sizeof(TelemetryCounters), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED)
+	{
+		printf("] Cant map the telemetry segment %s.\n", name);
+		return 1;
+	}
+	volatile TelemetryCounters* shared = memory;
+	if (__atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC ||
+			shared->version != TELEMETRY_VERSION)
+	{
+		printf("] %s is not a compatible telemetry segment.\n", name);
+		return 1;
+	}
+
+	printf("] frame | work sleep frame max (us) | length food queue | over game_overs restarts | skipped\n");
+	unsigned long long last_frame_index = 0;
+	for (;;)
+	{
+		TelemetryCounters counters;
+		if (read_counters(shared, &counters))
+		{
+			// the game unlinks the segment when it quits, but a crashed game just stops updating it.
+			if (counters.frame_index == last_frame_index) printf("] (stalled) ");
+			else printf("] ");
+			last_frame_index = counters.frame_index;
+
+			printf("%llu | %5u %5u %5u %5u | %u %u %u | %u %llu %llu | %llu\n",
+					(unsigned long long)counters.frame_index,
+					counters.work_us, counters.sleep_us, counters.frame_us, counters.max_work_us,
+					counters.snake_length, counters.active_food_count, counters.input_queue_depth,
+					counters.game_over,
+					(unsigned long long)counters.game_over_count, (unsigned long long)counters.restart_count,
+					(unsigned long long)counters.skipped_frame_count);
+			fflush(stdout);
+		}
+		usleep(interval_ms * 1000);
+	}
+	return 0;
+}